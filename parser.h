@@ -5,25 +5,269 @@
 #include <utility>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
+#include <bitset>
+#include <type_traits>
 #include <iostream>
 #include <sstream>
 #include <iterator>
+#include <functional>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace yidpp {
 		template<class T,class A>
 		class Parser;
 
+		template<class T,class A>
+		class Emp;
+
+
+		//stamps for versions and fixed point passes, only ever increase
+		inline unsigned long nextStamp() {
+			static thread_local unsigned long clock = 0;
+			return ++clock;
+		}
+
+		class FixedPoint;
 
 		//Data object for fixed point computation
 		class ChangeCell {
 			public:
-				ChangeCell() : changed(false) {};
+				ChangeCell() : changed(false), epoch(nextStamp()) {};
 				bool changed;
-				std::set<void*> seen;
+				//parsers remember the last pass they were visited in
+				unsigned long epoch;
+				//parsers this fixed point initialised
+				std::vector<FixedPoint*> reached;
 				bool orWith(bool change) {
 					changed = changed || change;
 					return changed;
 				}
+
+				void nextPass() {
+					changed = false;
+					epoch = nextStamp();
+				}
+
+				//the fixed point is complete, the attributes reached are final
+				void settleReached();
+
+				//the fixed point was abandoned, the attributes reached have to be
+				//computed again
+				void forgetReached();
+		};
+
+		//State of the lazy fixed point, common to parsers of every type
+		class FixedPoint {
+			friend class ChangeCell;
+			protected:
+				//has the fixed point been done
+				bool initialized = false;
+
+				//a fixed point that reached this has completed
+				bool settled = false;
+
+				//last fixed point pass this was visited in
+				unsigned long visitedEpoch = 0;
+
+				//stamp of the last recomputation from the children
+				unsigned long computedAt = 0;
+		};
+
+		inline void ChangeCell::settleReached() {
+			for(auto i=reached.begin();i!=reached.end();++i) {
+				(*i)->settled = true;
+			}
+		}
+
+		inline void ChangeCell::forgetReached() {
+			for(auto i=reached.begin();i!=reached.end();++i) {
+				(*i)->initialized = false;
+				(*i)->computedAt = 0;
+			}
+		}
+
+		//Flat set holding a parse forest, kept sorted by operator<. Most
+		//forests hold zero to two trees so those live inline without any
+		//allocation, larger ones move in to a vector
+		template<class A>
+		class Forest {
+			private:
+				static const std::size_t inlineSize = 2;
+				typename std::aligned_storage<sizeof(A),alignof(A)>::type small[inlineSize];
+				std::vector<A> large;
+				std::size_t used;
+
+				A* smallData() {
+					return reinterpret_cast<A*>(small);
+				}
+
+				const A* smallData() const {
+					return reinterpret_cast<const A*>(small);
+				}
+
+				bool isSmall() const {
+					return used <= inlineSize;
+				}
+
+				//takes over already sorted and unique values
+				void adopt(std::vector<A>&& values) {
+					clear();
+					std::size_t size = values.size();
+					if(size <= inlineSize) {
+						for(std::size_t i=0;i<size;++i) {
+							new (smallData()+i) A(std::move(values[i]));
+						}
+					} else {
+						large = std::move(values);
+					}
+					used = size;
+				}
+
+				void take(Forest&& other) {
+					if(other.isSmall()) {
+						for(std::size_t i=0;i<other.used;++i) {
+							new (smallData()+i) A(std::move(other.smallData()[i]));
+						}
+					} else {
+						large = std::move(other.large);
+					}
+					used = other.used;
+					other.clear();
+				}
+
+			public:
+				typedef const A* const_iterator;
+
+				Forest() : used(0) {};
+
+				Forest(const Forest& other) : used(0) {
+					if(other.isSmall()) {
+						for(std::size_t i=0;i<other.used;++i) {
+							new (smallData()+i) A(other.smallData()[i]);
+						}
+					} else {
+						large = other.large;
+					}
+					used = other.used;
+				}
+
+				Forest(Forest&& other) : used(0) {
+					take(std::move(other));
+				}
+
+				//arbitrary values, sorted and made unique
+				explicit Forest(std::vector<A>&& values) : used(0) {
+					std::sort(values.begin(),values.end());
+					values.erase(std::unique(values.begin(),values.end(),[](const A& a, const A& b) { return !(a < b) && !(b < a); }),values.end());
+					adopt(std::move(values));
+				}
+
+				Forest(const std::set<A>& values) : used(0) {
+					adopt(std::vector<A>(values.begin(),values.end()));
+				}
+
+				~Forest() {
+					clear();
+				}
+
+				Forest& operator=(Forest other) {
+					clear();
+					take(std::move(other));
+					return *this;
+				}
+
+				operator std::set<A>() const {
+					return std::set<A>(begin(),end());
+				}
+
+				const_iterator begin() const {
+					return isSmall() ? smallData() : large.data();
+				}
+
+				const_iterator end() const {
+					return begin() + used;
+				}
+
+				std::size_t size() const {
+					return used;
+				}
+
+				bool empty() const {
+					return used == 0;
+				}
+
+				std::size_t count(const A& value) const {
+					return std::binary_search(begin(),end(),value) ? 1 : 0;
+				}
+
+				void clear() {
+					if(isSmall()) {
+						for(std::size_t i=0;i<used;++i) {
+							smallData()[i].~A();
+						}
+					}
+					large.clear();
+					used = 0;
+				}
+
+				bool insert(A value) {
+					const A* position = std::lower_bound(begin(),end(),value);
+					if(position != end() && !(value < *position))
+						return false;
+					std::size_t index = position - begin();
+					if(used < inlineSize) {
+						A* data = smallData();
+						if(index == used) {
+							new (data+used) A(std::move(value));
+						} else {
+							//only ever one element to shift along
+							new (data+used) A(std::move(data[index]));
+							data[index] = std::move(value);
+						}
+					} else if(used == inlineSize) {
+						std::vector<A> grown;
+						grown.reserve(inlineSize*2);
+						for(std::size_t i=0;i<used;++i) {
+							grown.push_back(std::move(smallData()[i]));
+						}
+						grown.insert(grown.begin()+index,std::move(value));
+						adopt(std::move(grown));
+						return true;
+					} else {
+						large.insert(large.begin()+index,std::move(value));
+					}
+					++used;
+					return true;
+				}
+
+				//union with another forest in linear time
+				void merge(const Forest& other) {
+					if(other.empty())
+						return;
+					if(empty()) {
+						*this = other;
+						return;
+					}
+					std::vector<A> merged;
+					merged.reserve(used + other.used);
+					std::set_union(begin(),end(),other.begin(),other.end(),std::back_inserter(merged));
+					adopt(std::move(merged));
+				}
+
+				bool operator==(const Forest& other) const {
+					return used == other.used && std::equal(begin(),end(),other.begin(),[](const A& a, const A& b) { return !(a < b) && !(b < a); });
+				}
+
+				bool operator!=(const Forest& other) const {
+					return !(*this == other);
+				}
 		};
 
 		struct Node {
@@ -34,19 +278,357 @@ namespace yidpp {
 
 		typedef std::unordered_map<void*,Node> Graph;
 
+		//Byte sized terminals, characters and small enums, are ordered as
+		//unsigned bytes wherever a range is tested so a range like 'a' to
+		//'\xff' means the same to every scan and to the FIRST sets
+		template<class T>
+		struct IsByte : std::integral_constant<bool,(std::is_integral<T>::value || std::is_enum<T>::value) && sizeof(T) == 1> {};
+
+		template<class T>
+		bool inRange(const std::pair<T,T>& range, const T& t, std::false_type) {
+			return !(t < range.first) && !(range.second < t);
+		}
+
+		template<class T>
+		bool inRange(const std::pair<T,T>& range, const T& t, std::true_type) {
+			unsigned char c = static_cast<unsigned char>(t);
+			return static_cast<unsigned char>(range.first) <= c && c <= static_cast<unsigned char>(range.second);
+		}
+
+		//is t inside the inclusive range
+		template<class T>
+		bool inRange(const std::pair<T,T>& range, const T& t) {
+			return inRange(range,t,IsByte<T>());
+		}
+
+		//Set of terminals a language can start with. Terminals are hashable
+		//but not necessarily enumerable so ranges that are more than a single
+		//terminal make the set unbounded
+		template<class T, bool Small = IsByte<T>::value>
+		class FirstSet {
+			private:
+				bool any = false;
+				std::unordered_set<T> tokens;
+			public:
+				void insert(const T& t) {
+					if(!any)
+						tokens.insert(t);
+				}
+
+				void insertRange(const T& lo, const T& hi) {
+					if(lo < hi) {
+						any = true;
+						tokens.clear();
+					} else if(!(hi < lo)) {
+						insert(lo);
+					}
+				}
+
+				void merge(const FirstSet& other) {
+					if(other.any) {
+						any = true;
+						tokens.clear();
+					} else if(!any) {
+						tokens.insert(other.tokens.begin(),other.tokens.end());
+					}
+				}
+
+				bool contains(const T& t) const {
+					return any || tokens.count(t);
+				}
+
+				bool operator==(const FirstSet& other) const {
+					return any == other.any && tokens == other.tokens;
+				}
+
+				bool operator!=(const FirstSet& other) const {
+					return !(*this == other);
+				}
+		};
+
+		//byte sized terminals and token kinds are kept as a bitset
+		template<class T>
+		class FirstSet<T,true> {
+			private:
+				std::bitset<256> bits;
+
+				static std::size_t index(const T& t) {
+					return static_cast<unsigned char>(t);
+				}
+			public:
+				void insert(const T& t) {
+					bits.set(index(t));
+				}
+
+				void insertRange(const T& lo, const T& hi) {
+					for(std::size_t i=index(lo);i<=index(hi);++i) {
+						bits.set(i);
+					}
+				}
+
+				void merge(const FirstSet& other) {
+					bits |= other.bits;
+				}
+
+				bool contains(const T& t) const {
+					return bits.test(index(t));
+				}
+
+				bool operator==(const FirstSet& other) const {
+					return bits == other.bits;
+				}
+
+				bool operator!=(const FirstSet& other) const {
+					return !(*this == other);
+				}
+		};
+
+		//returns the end of the prefix of [begin,end) whose tokens all fall
+		//inside one of the inclusive ranges
+		template<class T>
+		const T* scanRanges(const std::pair<T,T>* ranges, std::size_t count, const T* begin, const T* end) {
+			for(;begin != end; ++begin) {
+				bool hit = false;
+				for(std::size_t r=0;r<count && !hit;++r) {
+					hit = inRange(ranges[r],*begin);
+				}
+				if(!hit)
+					return begin;
+			}
+			return end;
+		}
+
+		//byte input is scanned sixteen tokens at a time when SSE2 is available
+		inline const char* scanRanges(const std::pair<char,char>* ranges, std::size_t count, const char* begin, const char* end) {
+#ifdef __SSE2__
+			while(end - begin >= 16) {
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+				__m128i hit = _mm_setzero_si128();
+				for(std::size_t r=0;r<count;++r) {
+					//a range ending below where it starts is empty
+					if(static_cast<unsigned char>(ranges[r].second) < static_cast<unsigned char>(ranges[r].first))
+						continue;
+					//lo <= c <= hi is (c - lo) <= (hi - lo) in unsigned bytes
+					__m128i shifted = _mm_sub_epi8(block,_mm_set1_epi8(ranges[r].first));
+					__m128i width = _mm_set1_epi8(static_cast<char>(ranges[r].second - ranges[r].first));
+					hit = _mm_or_si128(hit,_mm_cmpeq_epi8(_mm_min_epu8(shifted,width),shifted));
+				}
+				int mask = _mm_movemask_epi8(hit);
+				if(mask != 0xFFFF)
+					return begin + __builtin_ctz(~mask);
+				begin += 16;
+			}
+#endif
+			return scanRanges<char>(ranges,count,begin,end);
+		}
+
+		//Limits on the resources a single parse may use, zero is unlimited
+		struct Budget {
+			//derivatives built
+			std::size_t maxNodes = 0;
+			//trees in any one parse forest
+			std::size_t maxForest = 0;
+			//passes over the graph by the fixed point computation
+			std::size_t maxIterations = 0;
+			//wall clock time from the start of the parse
+			std::chrono::steady_clock::duration timeLimit = std::chrono::steady_clock::duration::zero();
+		};
+
+		enum class ParseStatus {
+			Complete,
+			NodeBudgetExceeded,
+			ForestBudgetExceeded,
+			IterationBudgetExceeded,
+			DeadlineExceeded
+		};
+
+		//what a parse used up to the point it finished or was stopped
+		struct ParseStats {
+			std::size_t nodes = 0;
+			std::size_t largestForest = 0;
+			//trees paired up by concatenations
+			std::size_t trees = 0;
+			std::size_t iterations = 0;
+			std::size_t tokens = 0;
+			std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::duration::zero();
+		};
+
+		//thrown from inside the parser when a budget runs out, the parse that
+		//installed the budget catches it and unwinds the partial work
+		class BudgetExceeded : public std::exception {
+			public:
+				BudgetExceeded(ParseStatus status) : status(status) {};
+				ParseStatus status;
+				const char* what() const noexcept override {
+					return "parse budget exceeded";
+				}
+		};
+
+		template<class A>
+		struct ParseResult {
+			ParseStatus status = ParseStatus::Complete;
+			//only filled in when the parse completed
+			Forest<A> forest;
+			ParseStats stats;
+			bool complete() const {
+				return status == ParseStatus::Complete;
+			}
+		};
+
+		//Enforces a Budget for the parse running on this thread. The parser
+		//reports derivatives, passes and forests to the active governor, which
+		//also remembers the derivative cache entries made since the last
+		//commit so a stopped step can be taken back out of the grammar
+		template<class T>
+		class Governor {
+			public:
+				Governor(const Budget& budget) : budget(budget), previous(current()), start(std::chrono::steady_clock::now()) {
+					current() = this;
+				}
+
+				~Governor() {
+					current() = previous;
+				}
+
+				static Governor*& current() {
+					static thread_local Governor* active = nullptr;
+					return active;
+				}
+
+				//a derivative is about to be built and stored under key in cache
+				template<class A>
+				void derived(typename Parser<T,A>::ParserCache* cache, const T& key) {
+					journal.push_back(Entry{cache,key,&Governor<T>::undo<A>});
+					built();
+				}
+
+				//a derivative was built that no cache holds on to
+				void built() {
+					++stats.nodes;
+					if(budget.maxNodes != 0 && stats.nodes > budget.maxNodes)
+						throw BudgetExceeded(ParseStatus::NodeBudgetExceeded);
+					tick(1);
+				}
+
+				void pass() {
+					++stats.iterations;
+					if(budget.maxIterations != 0 && stats.iterations > budget.maxIterations)
+						throw BudgetExceeded(ParseStatus::IterationBudgetExceeded);
+					//a pass walks the new part of the graph, which costs more than the clock
+					checkDeadline();
+				}
+
+				//a forest of size trees is about to be built or was just built
+				void forest(std::size_t size) {
+					if(budget.maxForest != 0 && size > budget.maxForest)
+						throw BudgetExceeded(ParseStatus::ForestBudgetExceeded);
+					stats.largestForest = std::max(stats.largestForest,size);
+					//building large forests is where ambiguous grammars spend their time
+					tick(size);
+				}
+
+				//one tree was added to a forest under construction
+				void tree() {
+					++stats.trees;
+					tick(1);
+				}
+
+				//a step consumed count terminals, a run costs one step however
+				//long it is
+				void tokens(std::size_t count) {
+					stats.tokens += count;
+					tick(1);
+				}
+
+				//the step completed, its derivatives stay
+				void commit() {
+					journal.clear();
+				}
+
+				//take every derivative cached since the last commit back out
+				void rollback() {
+					for(auto i=journal.rbegin();i!=journal.rend();++i) {
+						i->undo(i->cache,i->key);
+					}
+					journal.clear();
+				}
+
+				ParseStats report() const {
+					ParseStats retval = stats;
+					retval.elapsed = std::chrono::steady_clock::now() - start;
+					return retval;
+				}
+
+			private:
+				struct Entry {
+					void* cache;
+					T key;
+					void (*undo)(void*,const T&);
+				};
+
+				template<class A>
+				static void undo(void* cache, const T& key) {
+					auto typed = static_cast<typename Parser<T,A>::ParserCache*>(cache);
+					auto found = typed->find(key);
+					if(found != typed->end()) {
+						//the partial derivative may refer back to itself so cut
+						//it loose before dropping it
+						auto node = found->second;
+						typed->erase(found);
+						node->release();
+					}
+				}
+
+				//reading the clock is not free so only do it once enough work
+				//has been done since the last time
+				void tick(std::size_t work) {
+					sinceClock += work;
+					if(sinceClock >= clockStride) {
+						sinceClock = 0;
+						checkDeadline();
+					}
+				}
+
+				void checkDeadline() {
+					if(budget.timeLimit != std::chrono::steady_clock::duration::zero() && std::chrono::steady_clock::now() - start > budget.timeLimit)
+						throw BudgetExceeded(ParseStatus::DeadlineExceeded);
+				}
+
+				Budget budget;
+				Governor* previous;
+				std::chrono::steady_clock::time_point start;
+				ParseStats stats;
+				std::vector<Entry> journal;
+				static const std::size_t clockStride = 256;
+				std::size_t sinceClock = 0;
+		};
+
+	//One fast forward through a run of terminals. Parsers remember the
+	//extent and derivative they worked out under its stamp, so a sub-grammar
+	//reached along several paths is measured and derived once per step
+	template<class T>
+	struct RunStep {
+		unsigned long stamp;
+		const T* begin;
+		const T* end;
+		//where the run stops, once every parser on the way has been measured
+		const T* stop;
+	};
+
 	//The abstract base class for all parsers
 	template<class T, class A>
-	class Parser : public std::enable_shared_from_this<Parser<T,A>> {
+	class Parser : public FixedPoint, public std::enable_shared_from_this<Parser<T,A>> {
 		public:
 		typedef std::unordered_map<T,std::shared_ptr<Parser<T,A>>> ParserCache;
 		
-		Parser() : initialized(false) {
+		Parser() {
 		};
 
 			//retreive the parse forest because the stream has terminated
-			std::set<A> parseNull() {
+			const Forest<A>& parseNull() {
 				if(isEmpty()) {
-					return std::set<A>();
+					static const Forest<A> none;
+					return none;
 				} else {
 					init();
 					return parseNullLocal;
@@ -69,17 +651,154 @@ namespace yidpp {
 				return isEmptyLocal;
 			}
 
+			//getter for the terminals the language can start with
+			const FirstSet<T>& firstTokens() {
+				init();
+				return firstTokensLocal;
+			}
+
+			//the attributes as far as the running fixed point has got. Parsers
+			//read their children through these while updating, the getters
+			//above would start a nested fixed point part way through this one
+			const Forest<A>& parseNullSoFar() const {
+				return parseNullLocal;
+			}
+
+			bool isEmptySoFar() const {
+				return isEmptyLocal;
+			}
+
+			bool isNullableSoFar() const {
+				return !isEmptyLocal && isNullableLocal;
+			}
+
+			const FirstSet<T>& firstTokensSoFar() const {
+				return firstTokensLocal;
+			}
+
 			//take the derivative with respect to a terminal pretty much the main algorithm
 			std::shared_ptr<Parser<T,A>> derive (T t) {
 				
 				//should do an is empty check here 
 				if (cache.count(t)) {
 					return cache.find(t)->second; //if seen before return previous result
+				} else if (!firstTokens().contains(t)) {
+					return Emp<T,A>::canonical(); //nothing starts with t, no need to build anything
 				} else {
+						if(Governor<T>* governor = Governor<T>::current())
+							governor->template derived<A>(&cache,t);
 						return internalDerive(t,cache);  //new get the internal derivative
 				}
 			}
 
+			//take the derivative with respect to a run of terminals, the parser
+			//may consume as much of [begin,end) as it can in one step and sets
+			//next to the first terminal it did not consume
+			std::shared_ptr<Parser<T,A>> deriveRun(const T* begin, const T* end, const T*& next) {
+				RunStep<T> step{nextStamp(),begin,end,begin};
+				if(end - begin >= 2)
+					step.stop = runExtent(step);
+				//a run of one is no better than the cached derivative
+				if(step.stop - begin < 2) {
+					next = begin + 1;
+					return derive(*begin);
+				}
+				next = step.stop;
+				return deriveRunTo(step);
+			}
+
+			//how far a fast forward from step.begin can go without having to
+			//step through the terminals one at a time
+			const T* runExtent(const RunStep<T>& step) {
+				if(runStamp != step.stamp) {
+					runStamp = step.stamp;
+					runDerived.reset();
+					//a grammar that leads back here while it is measured ends
+					//the run where it starts
+					runReach = step.begin;
+					runReach = internalRunExtent(step);
+				}
+				return runReach;
+			}
+
+			//derivative by [step.begin,step.stop), which runExtent has to have
+			//found reaches at least that far
+			std::shared_ptr<Parser<T,A>> deriveRunTo(const RunStep<T>& step) {
+				runExtent(step);
+				if(auto found = runDerived.lock())
+					return found;
+				auto retval = internalDeriveRun(step);
+				runDerived = retval;
+				return retval;
+			}
+
+			//for parsers matching a single terminal out of a class, the end of the
+			//prefix of [begin,end) made up of terminals in the class
+			virtual const T* scanClass(const T* begin, const T* end) {
+				return begin;
+			}
+
+			//derive by every terminal in [begin,end) skipping through runs
+			std::shared_ptr<Parser<T,A>> deriveRange(const T* begin, const T* end) {
+				std::shared_ptr<Parser<T,A>> current = this->shared_from_this();
+				while(begin != end) {
+					const T* next = begin;
+					current = current->deriveRun(begin,end,next);
+					begin = next;
+				}
+				return current;
+			}
+
+			//parse the entire input stream within the budget, if it runs out
+			//the grammar is left as it was before the step that ran out
+			ParseResult<A> parseLimited(const std::vector<T>& input, const Budget& budget) {
+				bool taken = false;
+				return parseChunks([&](const T*& begin, const T*& end) {
+					if(taken)
+						return false;
+					begin = input.data();
+					end = begin + input.size();
+					taken = true;
+					return true;
+				},budget);
+			}
+
+			//parseLimited over input handed over a chunk at a time, source sets
+			//[begin,end) to the next chunk and returns false once the input is
+			//exhausted
+			template<class Source>
+			ParseResult<A> parseChunks(Source source, const Budget& budget) {
+				Governor<T> governor(budget);
+				ParseResult<A> result;
+				try {
+					std::shared_ptr<Parser<T,A>> current = this->shared_from_this();
+					current->isEmpty();
+					governor.commit();
+					const T* begin;
+					const T* end;
+					while(source(begin,end)) {
+						while(begin != end) {
+							const T* next = begin;
+							auto derived = current->deriveRun(begin,end,next);
+							derived->isEmpty();
+							governor.commit();
+							current = derived;
+							governor.tokens(next - begin);
+							begin = next;
+						}
+					}
+					result.forest = current->parseNull();
+				} catch(const BudgetExceeded& e) {
+					governor.rollback();
+					result.status = e.status;
+				} catch(...) {
+					governor.rollback();
+					throw;
+				}
+				result.stats = governor.report();
+				return result;
+			}
+
 			//parse the entire input stream and return the forest
 			virtual std::set<A> parseFull(const std::vector<T>& input) { 
 				if (input.empty()) {
@@ -94,8 +813,8 @@ namespace yidpp {
 			virtual std::set<std::pair<A,std::vector<T>>> parse(const std::vector<T>& input) {
 				if (input.empty()) { 
 					std::set<std::pair<A,std::vector<T>>> parseSet;
-					std::set<A> parseNullResult = parseNull();
-					for(typename std::set<A>::iterator i=parseNullResult.begin(); i != parseNullResult.end(); ++i) {
+					const Forest<A>& parseNullResult = parseNull();
+					for(auto i=parseNullResult.begin(); i != parseNullResult.end(); ++i) {
 						parseSet.insert(std::make_pair(*i,std::vector<T>()));
 					}
 					return parseSet;
@@ -111,15 +830,25 @@ namespace yidpp {
 		
 			//virtual method for fixed point computation
 			void updateChildBasedAttributes(ChangeCell& change) {
-				void* localPtr = this;
-				if(!change.seen.count(localPtr)) {
-					change.seen.insert(localPtr);
+				//a settled parser has final attributes, nothing below it can change
+				if(settled)
+					return;
+				if(visitedEpoch != change.epoch) {
+					visitedEpoch = change.epoch;
+					if(!initialized) {
+						initialized=true;
+						change.reached.push_back(this);
+					}
 					oneShotUpdate(change);
-					initialized=true;
 				}
 				allUpdate(change);
 			}
 
+			//stamp of the last change to any of the attributes
+			unsigned long attributeVersion() const {
+				return version;
+			}
+
 			virtual void treeRecurse(Graph& valueSet) {
 				if(!valueSet.count(this)) {
 					Node temp;
@@ -141,17 +870,35 @@ namespace yidpp {
 				return "UNKNOWN";
 			}
 
+			//drop the children so a derivative that is being thrown away
+			//does not keep itself alive through a cycle
+			virtual void release() {};
+
 		protected:
-			//has the fixed point been done
-			bool initialized;
-			
 			//virtual method for popping the derivative
 			virtual std::shared_ptr<Parser<T,A>> internalDerive (T t, typename Parser<T,A>::ParserCache&) = 0;
 
+			//virtual methods for fast forwarding, parsers that cannot skip
+			//through a run end it where it starts
+			virtual const T* internalRunExtent(const RunStep<T>& step) {
+				return step.begin;
+			}
+
+			virtual std::shared_ptr<Parser<T,A>> internalDeriveRun(const RunStep<T>& step) {
+				std::shared_ptr<Parser<T,A>> retval = derive(*step.begin);
+				for(const T* i=step.begin+1;i!=step.stop;++i) {
+					retval = retval->derive(*i);
+				}
+				return retval;
+			}
+
 			//setter for parse forest and checks if changed
-			bool parseNullSet(std::set<A> set) {
+			bool parseNullSet(Forest<A> set) {
+				if(Governor<T>* governor = Governor<T>::current())
+					governor->forest(set.size());
 				if(parseNullLocal != set) {
-					parseNullLocal = set;
+					parseNullLocal = std::move(set);
+					version = nextStamp();
 					return true;
 				} else {
 					return false;
@@ -162,6 +909,18 @@ namespace yidpp {
 			bool isEmptySet(bool v) {
 				if(isEmptyLocal != v) {
 					isEmptyLocal = v;
+					version = nextStamp();
+					return true;
+				} else {
+					return false;
+				}
+			}
+
+			//setter for first terminals and checks if changed
+			bool firstTokensSet(const FirstSet<T>& v) {
+				if(firstTokensLocal != v) {
+					firstTokensLocal = v;
+					version = nextStamp();
 					return true;
 				} else {
 					return false;
@@ -172,6 +931,7 @@ namespace yidpp {
 			bool isNullableSet(bool v) {
 				if(isNullableLocal != v) {
 					isNullableLocal = v;
+					version = nextStamp();
 					return true;
 				} else {
 					return false;
@@ -179,31 +939,67 @@ namespace yidpp {
 			}
 
 
+			//true when the newest version among the inputs is newer than the
+			//last recomputation, which is then stamped as happening now
+			bool needsUpdate(unsigned long newest) {
+				if(computedAt != 0 && newest <= computedAt)
+					return false;
+				computedAt = nextStamp();
+				return true;
+			}
+
 			virtual void oneShotUpdate(ChangeCell&) {};
 			virtual void allUpdate(ChangeCell&) {};
+
+			//derive reports the derivatives it builds, deriveRun builds some
+			//of its own
+			static void reportBuilt() {
+				if(Governor<T>* governor = Governor<T>::current())
+					governor->built();
+			}
 			
 			//contains the current parse forest for it
-			std::set<A> parseNullLocal;
+			Forest<A> parseNullLocal;
 			
 			//Nullable and Empty status of the class
 			bool isEmptyLocal = false;
 			bool isNullableLocal = false;
 
+			//terminals the language can start with
+			FirstSet<T> firstTokensLocal;
+
 		private:
 			
 			//cache of derivative results
 			ParserCache cache;
-			
+
+			//stamp of the last change to any attribute
+			unsigned long version = 0;
+
+			//what the run step with stamp runStamp worked out here, the
+			//derivative is held by whatever it was built for
+			unsigned long runStamp = 0;
+			const T* runReach = nullptr;
+			std::weak_ptr<Parser<T,A>> runDerived;
+
 			//performs the fixed point update of the properties
 			void init() {
 				if(initialized)
 					return;
-				initialized = true;
 				ChangeCell change;
-				do {
-					change = ChangeCell();
-					updateChildBasedAttributes(change);
-				} while(change.changed);
+				try {
+					do {
+						if(Governor<T>* governor = Governor<T>::current())
+							governor->pass();
+						change.nextPass();
+						updateChildBasedAttributes(change);
+					} while(change.changed);
+				} catch(...) {
+					change.forgetReached();
+					throw;
+				}
+				//the last pass changed nothing so everything it reached is final
+				change.settleReached();
 			}
 };
 
@@ -226,6 +1022,12 @@ class Emp : public Parser<T,A> {
 		std::string getLabel() override {
 			return "Empty_Set";
 		}
+
+		//the empty parser has no state so one instance is shared
+		static std::shared_ptr<Parser<T,A>> canonical() {
+			static std::shared_ptr<Parser<T,A>> instance = std::make_shared<Emp<T,A>>();
+			return instance;
+		}
   protected:
 		
 		std::shared_ptr<Parser<T,A>> internalDerive (T t, typename Parser<T,A>::ParserCache& cache) override {
@@ -239,7 +1041,7 @@ class Emp : public Parser<T,A> {
 template<class T, class A>
 class Eps : public Parser<T,A> {
 	public:
-		Eps(std::set<A> generator) {
+		Eps(Forest<A> generator) {
 			//The empty string is not the Null Set
 			//it contains only the empty string and is
 			//thus non empty
@@ -251,7 +1053,7 @@ class Eps : public Parser<T,A> {
 			
 			//The Character consumed (or possible parse trees consumed) to produce this is
 			//what should be returned on a null parse
-			Parser<T,A>::parseNullSet(generator);
+			Parser<T,A>::parseNullSet(std::move(generator));
 		}
 
 
@@ -263,7 +1065,7 @@ class Eps : public Parser<T,A> {
 		//if you take the derivative of it you get the null set
 		//which is no parser at all
 		virtual std::shared_ptr<Parser<T,A>> internalDerive(T t, typename Parser<T,A>::ParserCache& cache) override {
-			auto retval = std::make_shared<Emp<T,A>>();
+			auto retval = Emp<T,A>::canonical();
 			cache.insert(std::make_pair(t,retval));
 			return retval;
 		}
@@ -271,7 +1073,7 @@ class Eps : public Parser<T,A> {
 	public:
 	virtual	std::set<std::pair<A,std::vector<T>>> parse(const std::vector<T>& input) override {
 			std::set<std::pair<A,std::vector<T>>> retval;
-			auto parseNullResult = Parser<T,A>::parseNull();
+			const auto& parseNullResult = Parser<T,A>::parseNull();
 			for(auto i = parseNullResult.begin(); i!= parseNullResult.end(); ++i) {
 				retval.insert(std::make_pair(*i,input));
 			}
@@ -291,6 +1093,7 @@ class EqT : public Parser<T,T> {
 			//and item (the single terminal) and does not contain the empty string
 			Parser<T,T>::isEmptySet(false);
 			Parser<T,T>::isNullableSet(false);
+			Parser<T,T>::firstTokensLocal.insert(t);
 		}
 	
 		virtual std::set<std::pair<T,std::vector<T>>> parse(const std::vector<T>& input) override {
@@ -304,13 +1107,18 @@ class EqT : public Parser<T,T> {
 		std::string getLabel() override {
 			return "TerminalParser";
 		}
+
+		virtual const T* scanClass(const T* begin, const T* end) override {
+			std::pair<T,T> range(t,t);
+			return scanRanges(&range,1,begin,end);
+		}
   protected:
 
 		virtual std::shared_ptr<Parser<T,T>> internalDerive(T t_, typename Parser<T,T>::ParserCache& cache) override {
 			if(t == t_) {
 				//derivative of the single terminal is the null reduction parser
 				//formed with t as the construction option
-				std::set<T> generator;
+				Forest<T> generator;
 				generator.insert(t);
 				auto retval = std::make_shared<Eps<T,T>>(generator); 
 				cache.insert(std::make_pair(t_,retval));
@@ -318,19 +1126,85 @@ class EqT : public Parser<T,T> {
 			} else {
 				//if not equal cannot be part of language
 				//therefore null set or empty parser
-				auto retval = std::make_shared<Emp<T,T>>();
+				auto retval = Emp<T,T>::canonical();
 				cache.insert(std::make_pair(t_,retval));
 				return retval;
 			}
 		}
 };
 
+//parser for a single terminal out of a class of terminals, the class
+//is given as a list of inclusive ranges eg whitespace, digits
+template<class T>
+class Cls : public Parser<T,T> {
+	private:
+		std::vector<std::pair<T,T>> ranges;
+	public:
+		Cls() {
+			//same as the single terminal, neither empty nor nullable
+			Parser<T,T>::isEmptySet(false);
+			Parser<T,T>::isNullableSet(false);
+		}
+
+		Cls(T lo, T hi) : Cls() {
+			addRange(lo,hi);
+		}
+
+		void addRange(T lo, T hi) {
+			ranges.push_back(std::make_pair(lo,hi));
+			Parser<T,T>::firstTokensLocal.insertRange(lo,hi);
+		}
+
+		virtual std::set<std::pair<T,std::vector<T>>> parse(const std::vector<T>& input) override {
+			std::set<std::pair<T,std::vector<T>>> retval;
+			if(!input.empty() && scanClass(&input.front(),&input.front()+1) != &input.front()) {
+				retval.insert(std::make_pair(input.front(), std::vector<T>(++input.begin(), input.end())));
+			}
+			return retval;
+		}
+
+		std::string getLabel() override {
+			return "ClassParser";
+		}
+
+		virtual const T* scanClass(const T* begin, const T* end) override {
+			return scanRanges(ranges.data(),ranges.size(),begin,end);
+		}
+	protected:
+
+		virtual std::shared_ptr<Parser<T,T>> internalDerive(T t, typename Parser<T,T>::ParserCache& cache) override {
+			if(scanClass(&t,&t+1) != &t) {
+				//a member of the class derives to the null reduction parser
+				Forest<T> generator;
+				generator.insert(t);
+				auto retval = std::make_shared<Eps<T,T>>(generator);
+				cache.insert(std::make_pair(t,retval));
+				return retval;
+			} else {
+				auto retval = Emp<T,T>::canonical();
+				cache.insert(std::make_pair(t,retval));
+				return retval;
+			}
+		}
+};
+
 //Union
 template<class T,class A>
 class Alt : public Parser<T,A> {
 	private:
 		std::set<std::shared_ptr<Parser<T,A>>> unioned_parsers;
 
+		//the choices that survive a derivative by t
+		std::vector<Parser<T,A>*> matching(const T& t) {
+			std::vector<Parser<T,A>*> retval;
+			for(auto i=unioned_parsers.begin();i!=unioned_parsers.end();++i) {
+				if(!((*i)->isEmpty()) && (*i)->firstTokens().contains(t)) {
+					retval.push_back(i->get());
+				}
+			}
+			return retval;
+		}
+
 	public:
 		void addParser(std::shared_ptr<Parser<T,A>> parser) {
 			unioned_parsers.insert(parser);
@@ -353,21 +1227,44 @@ class Alt : public Parser<T,A> {
 		std::string getLabel() override {
 			return "Union";
 		}
+
+		virtual void release() override {
+			unioned_parsers.clear();
+		}
 	protected:
 
+		//a run goes as far as every choice still alive at its start can go
+		virtual const T* internalRunExtent(const RunStep<T>& step) override {
+			auto live = matching(*step.begin);
+			if(live.empty())
+				return step.begin;
+			const T* stop = step.end;
+			for(auto i=live.begin();i!=live.end() && stop!=step.begin;++i) {
+				stop = std::min(stop,(*i)->runExtent(step));
+			}
+			return stop;
+		}
+
+		//every choice still alive was measured to cover the run
+		virtual std::shared_ptr<Parser<T,A>> internalDeriveRun(const RunStep<T>& step) override {
+			auto live = matching(*step.begin);
+			Parser<T,A>::reportBuilt();
+			auto retval = std::make_shared<Alt<T,A>>();
+			for(auto i=live.begin();i!=live.end();++i) {
+				retval->addParser((*i)->deriveRunTo(step));
+			}
+			return retval;
+		}
+
 		virtual std::shared_ptr<Parser<T,A>> internalDerive(T t,typename Parser<T,A>::ParserCache& cache) override {
 
 			//Quick optimization
-			//if a choice is empty dont include it in the next union
-			std::set<std::shared_ptr<Parser<T,A>>> nonEmptySet;
-			for(auto i=unioned_parsers.begin();i!=unioned_parsers.end();++i) {
-				if(!((*i)->isEmpty())) {
-					nonEmptySet.insert(*i);
-				}
-			}
+			//only choices that are non empty and can start with t
+			//contribute anything to the next union
+			std::vector<Parser<T,A>*> live = matching(t);
 			
-			if(nonEmptySet.size() == 0) {
-				auto retval = std::make_shared<Emp<T,A>>();
+			if(live.size() == 0) {
+				auto retval = Emp<T,A>::canonical();
 				cache.insert(std::make_pair(t,retval));
 				return retval;
 			}
@@ -375,7 +1272,7 @@ class Alt : public Parser<T,A> {
 			auto retval = std::make_shared<Alt<T,A>>();
 			cache.insert(std::make_pair(t,retval));
 			
-			for(auto i=unioned_parsers.begin();i!=unioned_parsers.end();++i) {
+			for(auto i=live.begin();i!=live.end();++i) {
 				retval->addParser((*i)->derive(t));
 			}
 			
@@ -390,19 +1287,28 @@ class Alt : public Parser<T,A> {
 		}
 
 		virtual void allUpdate(ChangeCell& change) override {
-			std::set<A> nullSet;
+			unsigned long newest = 0;
+			for(auto i=unioned_parsers.begin();i!=unioned_parsers.end();++i) {
+				newest = std::max(newest,(*i)->attributeVersion());
+			}
+			if(!Parser<T,A>::needsUpdate(newest))
+				return;
+
+			Forest<A> nullSet;
+			FirstSet<T> tempFirst;
 			bool tempEmpty = true;
 			bool tempNullable = false;
 			for(auto i=unioned_parsers.begin();i!=unioned_parsers.end();++i) {
-				auto temp = (*i)->parseNull();
-				nullSet.insert(temp.begin(),temp.end());
-				tempEmpty = tempEmpty && (*i)->isEmpty();
-				tempNullable = tempNullable || (*i)->isNullable(); 
+				nullSet.merge((*i)->parseNullSoFar());
+				tempFirst.merge((*i)->firstTokensSoFar());
+				tempEmpty = tempEmpty && (*i)->isEmptySoFar();
+				tempNullable = tempNullable || (*i)->isNullableSoFar(); 
 			}
 			
-			change.orWith (Parser<T,A>::parseNullSet(nullSet));
+			change.orWith (Parser<T,A>::parseNullSet(std::move(nullSet)));
+			change.orWith (Parser<T,A>::firstTokensSet(tempFirst));
 			change.orWith (Parser<T,A>::isEmptySet(tempEmpty));
-			change.orWith (Parser<T,A>::isNullableSet(!this->isEmpty() && tempNullable));
+			change.orWith (Parser<T,A>::isNullableSet(!tempEmpty && tempNullable));
 		}
 		
 };
@@ -434,10 +1340,37 @@ class Con : public Parser<T,std::pair<A,B>> {
 		std::string getLabel() override {
 			return "Concatenation";
 		}
+
+		virtual void release() override {
+			first.reset();
+			second.reset();
+		}
 	protected:
+		//a run can stay entirely inside the left side as long as the right
+		//side cannot start with any of its terminals
+		virtual const T* internalRunExtent(const RunStep<T>& step) override {
+			if(first->isEmpty() || second->isEmpty())
+				return step.begin;
+			const T* stop = first->runExtent(step);
+			const FirstSet<T>& secondFirst = second->firstTokens();
+			for(const T* i=step.begin;i!=stop;++i) {
+				if(secondFirst.contains(*i))
+					return i;
+			}
+			return stop;
+		}
+
+		virtual std::shared_ptr<Parser<T,std::pair<A,B>>> internalDeriveRun(const RunStep<T>& step) override {
+			Parser<T,std::pair<A,B>>::reportBuilt();
+			auto retval = std::make_shared<Con<T,A,B>>();
+			retval->setLeft(first->deriveRunTo(step));
+			retval->setRight(second);
+			return retval;
+		}
+
 		virtual std::shared_ptr<Parser<T,std::pair<A,B>>> internalDerive(T t,typename Parser<T,std::pair<A,B>>::ParserCache& cache) override {
 			if(first->isEmpty() || second->isEmpty()) {
-				auto retval = std::make_shared<Emp<T,std::pair<A,B>>>();
+				auto retval = Emp<T,std::pair<A,B>>::canonical();
 				cache.insert(std::make_pair(t,retval));
 				return retval;
 			}
@@ -445,13 +1378,16 @@ class Con : public Parser<T,std::pair<A,B>> {
 			auto retUnion = std::make_shared<Alt<T,std::pair<A,B>>>();
 			cache.insert(std::make_pair(t,retUnion));
 
-			auto leftDerive = first->derive(t);
-			auto LeftCat = std::make_shared<Con<T,A,B>>();
-			LeftCat->setLeft(leftDerive);
-			LeftCat->setRight(second);
-			retUnion->addParser(LeftCat);
+			//each side only contributes if it can start with t
+			if(first->firstTokens().contains(t)) {
+				auto leftDerive = first->derive(t);
+				auto LeftCat = std::make_shared<Con<T,A,B>>();
+				LeftCat->setLeft(leftDerive);
+				LeftCat->setRight(second);
+				retUnion->addParser(LeftCat);
+			}
 
-			if(first->isNullable()) {
+			if(first->isNullable() && second->firstTokens().contains(t)) {
 				auto nullability = std::make_shared<Eps<T,A>>(first->parseNull());
 				auto rightCat = std::make_shared<Con<T,A,B>>();
 				rightCat->setLeft(nullability);
@@ -469,17 +1405,32 @@ class Con : public Parser<T,std::pair<A,B>> {
 		}
 
 		virtual void allUpdate(ChangeCell& change) override {
-			std::set<std::pair<A,B>> options;
-			auto firstNull = first->parseNull();
-			auto secondNull = second->parseNull();
+			if(!Parser<T,std::pair<A,B>>::needsUpdate(std::max(first->attributeVersion(),second->attributeVersion())))
+				return;
+
+			Forest<std::pair<A,B>> options;
+			const auto& firstNull = first->parseNullSoFar();
+			const auto& secondNull = second->parseNullSoFar();
+			//the product can be far larger than either side, so it is held
+			//to the budget before and while it is built
+			Governor<T>* governor = Governor<T>::current();
+			if(governor)
+				governor->forest(firstNull.size()*secondNull.size());
 			for(auto i=firstNull.begin();i!=firstNull.end(); ++i) {
 				for(auto j=secondNull.begin();j!=secondNull.end(); ++j) {
 					options.insert(std::make_pair(*i,*j));
+					if(governor)
+						governor->tree();
 				}
 			}
-			change.orWith(Parser<T,std::pair<A,B>>::parseNullSet(options));
-			change.orWith(Parser<T,std::pair<A,B>>::isEmptySet(first->isEmpty() || second->isEmpty()));
-			change.orWith(Parser<T,std::pair<A,B>>::isNullableSet(!Parser<T,std::pair<A,B>>::isEmpty() &&(first->isNullable() && second->isNullable())));
+			change.orWith(Parser<T,std::pair<A,B>>::parseNullSet(std::move(options)));
+			FirstSet<T> tempFirst = first->firstTokensSoFar();
+			if(first->isNullableSoFar())
+				tempFirst.merge(second->firstTokensSoFar());
+			bool tempEmpty = first->isEmptySoFar() || second->isEmptySoFar();
+			change.orWith(Parser<T,std::pair<A,B>>::firstTokensSet(tempFirst));
+			change.orWith(Parser<T,std::pair<A,B>>::isEmptySet(tempEmpty));
+			change.orWith(Parser<T,std::pair<A,B>>::isNullableSet(!tempEmpty && first->isNullableSoFar() && second->isNullableSoFar()));
 		}
 };
 
@@ -489,9 +1440,12 @@ template<class T, class A, class B>
 class Red : public Parser<T,B> {
   private:
 		std::shared_ptr<Parser<T,A>> localParser;
-		std::function<B(A)> reductionFunction;
+		//every call gets its own copy of a tree from the child's forest,
+		//which stays as it is. The copy is passed as an rvalue so the
+		//reduction can move out of it, functions taking A by value work too
+		std::function<B(A&&)> reductionFunction;
 	public:
-		Red(std::function<B(A)> redfunc): reductionFunction(redfunc) {};
+		Red(std::function<B(A&&)> redfunc): reductionFunction(std::move(redfunc)) {};
 		void setParser(std::shared_ptr<Parser<T,A>> input) { localParser = input;};
 		
 		virtual std::vector<void*> getChildren() {
@@ -507,14 +1461,31 @@ class Red : public Parser<T,B> {
 		std::string getLabel() override {
 			return "ReductionOperation";
 		}
+
+		virtual void release() override {
+			localParser.reset();
+		}
+
 	
 	protected:
+		virtual const T* internalRunExtent(const RunStep<T>& step) override {
+			return localParser->runExtent(step);
+		}
+
+		//derivative of the reduction is the reduction of the derivative
+		virtual std::shared_ptr<Parser<T,B>> internalDeriveRun(const RunStep<T>& step) override {
+			Parser<T,B>::reportBuilt();
+			auto retval = std::make_shared<Red<T,A,B>>(reductionFunction);
+			retval->setParser(localParser->deriveRunTo(step));
+			return retval;
+		}
+
 		virtual std::shared_ptr<Parser<T,B>> internalDerive(T t, typename Parser<T,B>::ParserCache& cache) override {
 			
 			//If internal parser which you are reducing is the Null Parser
 			//Then the result is simply the Null Parser of the correct type
 			if(localParser->isEmpty()) {
-				auto retval = std::make_shared<Emp<T,B>>();
+				auto retval = Emp<T,B>::canonical();
 				cache.insert(std::make_pair(t,retval));
 				return retval;
 			}
@@ -532,7 +1503,7 @@ class Red : public Parser<T,B> {
 			std::set<B> retval;
 			//Just take the internal Parse Forest and reduce it.
 			for(auto i=lower.begin();i!=lower.end();++i) {
-				retval.insert(reductionFunction(*i));
+				retval.insert(reductionFunction(A(*i)));
 			}
 			return retval;
 		}
@@ -541,7 +1512,7 @@ class Red : public Parser<T,B> {
 			std::set<std::pair<A,std::vector<T>>> lower = localParser->parse(input);
 			std::set<std::pair<B,std::vector<T>>> retval;
 			for(auto i=lower.begin();i!=lower.end();++i) {
-				retval.insert(std::make_pair(reductionFunction(i->first),i->second));
+				retval.insert(std::make_pair(reductionFunction(A(i->first)),i->second));
 			}
 			return retval;
 		}
@@ -552,37 +1523,193 @@ class Red : public Parser<T,B> {
 		}
 
 		virtual void allUpdate(ChangeCell& change) override {
-			change.orWith(Parser<T,B>::isEmptySet(localParser->isEmpty()));
-			change.orWith(Parser<T,B>::isNullableSet(localParser->isNullable()));
+			if(!Parser<T,B>::needsUpdate(localParser->attributeVersion()))
+				return;
+
+			change.orWith(Parser<T,B>::isEmptySet(localParser->isEmptySoFar()));
+			change.orWith(Parser<T,B>::isNullableSet(localParser->isNullableSoFar()));
+			change.orWith(Parser<T,B>::firstTokensSet(localParser->firstTokensSoFar()));
 			
-			auto localParseNull = localParser->parseNull();
-			std::set<B> changedParseNull;
+			const auto& localParseNull = localParser->parseNullSoFar();
+			std::vector<B> changedParseNull;
+			changedParseNull.reserve(localParseNull.size());
 			for(auto i=localParseNull.begin();i!=localParseNull.end();++i) {
-				changedParseNull.insert(reductionFunction(*i));
+				changedParseNull.push_back(reductionFunction(A(*i)));
 			}
-			change.orWith(Parser<T,B>::parseNullSet(changedParseNull));
+			change.orWith(Parser<T,B>::parseNullSet(Forest<B>(std::move(changedParseNull))));
 		}
 };
 
+//Persistent sequence used for the results of repetition. It is a list of
+//spans of shared buffers, prepending an element or a span shares the
+//rest of the sequence and is O(1). Elements are only copied out when it is
+//turned into a vector
+template<class A>
+class Seq {
+	private:
+		struct Cell {
+			std::shared_ptr<const std::vector<A>> buffer;
+			std::size_t from;
+			std::size_t to;
+			std::shared_ptr<const Cell> next;
+			//elements in this cell and all the ones after it
+			std::size_t size;
+		};
+		std::shared_ptr<const Cell> root;
+
+		void prepend(std::shared_ptr<const std::vector<A>> buffer, std::size_t from, std::size_t to, const Seq& tail) {
+			if(from == to) {
+				root = tail.root;
+				return;
+			}
+			auto cell = std::make_shared<Cell>();
+			cell->buffer = std::move(buffer);
+			cell->from = from;
+			cell->to = to;
+			cell->next = tail.root;
+			cell->size = (to - from) + tail.size();
+			root = cell;
+		}
+
+	public:
+		class const_iterator {
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef A value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const A* pointer;
+				typedef const A& reference;
+
+				const_iterator(const Cell* cell) : cell(cell), index(cell ? cell->from : 0) {};
+				const A& operator*() const { return (*cell->buffer)[index]; }
+				const A* operator->() const { return &(*cell->buffer)[index]; }
+				const_iterator& operator++() {
+					if(++index == cell->to) {
+						cell = cell->next.get();
+						index = cell ? cell->from : 0;
+					}
+					return *this;
+				}
+				bool operator==(const const_iterator& other) const { return cell == other.cell && index == other.index; }
+				bool operator!=(const const_iterator& other) const { return !(*this == other); }
+			private:
+				const Cell* cell;
+				std::size_t index;
+		};
+
+		//the empty sequence
+		Seq() {};
+
+		//head followed by tail
+		Seq(A head, const Seq& tail) {
+			prepend(std::make_shared<const std::vector<A>>(1,std::move(head)),0,1,tail);
+		}
+
+		//the elements [from,to) of buffer followed by tail, they must never
+		//change or move for as long as the sequence is around
+		Seq(std::shared_ptr<const std::vector<A>> buffer, std::size_t from, std::size_t to, const Seq& tail) {
+			prepend(std::move(buffer),from,to,tail);
+		}
+
+		std::size_t size() const {
+			return root ? root->size : 0;
+		}
+
+		bool empty() const {
+			return !root;
+		}
+
+		const_iterator begin() const {
+			return const_iterator(root.get());
+		}
+
+		const_iterator end() const {
+			return const_iterator(nullptr);
+		}
+
+		std::vector<A> toVector() const {
+			std::vector<A> retval;
+			retval.reserve(size());
+			for(const Cell* i=root.get();i!=nullptr;i=i->next.get()) {
+				retval.insert(retval.end(),i->buffer->begin()+i->from,i->buffer->begin()+i->to);
+			}
+			return retval;
+		}
+
+		bool operator==(const Seq& other) const {
+			if(size() != other.size())
+				return false;
+			std::pair<const Cell*,const Cell*> rest = skipShared(other);
+			return rest.first == rest.second || std::equal(const_iterator(rest.first),end(),const_iterator(rest.second));
+		}
+
+		bool operator!=(const Seq& other) const {
+			return !(*this == other);
+		}
+
+		bool operator<(const Seq& other) const {
+			std::pair<const Cell*,const Cell*> rest = skipShared(other);
+			if(rest.first == rest.second)
+				return false;
+			return std::lexicographical_compare(const_iterator(rest.first),end(),const_iterator(rest.second),end());
+		}
+
+	private:
+		//step past the leading cells that are the same span of the same
+		//buffer, rebuilding a result over a growing run gives a new cell
+		//for the same elements every time
+		std::pair<const Cell*,const Cell*> skipShared(const Seq& other) const {
+			const Cell* a = root.get();
+			const Cell* b = other.root.get();
+			while(a != b && a && b && a->buffer == b->buffer && a->from == b->from && a->to == b->to) {
+				a = a->next.get();
+				b = b->next.get();
+			}
+			return std::make_pair(a,b);
+		}
+};
+
+template<class T, class A>
+class Run;
+
+//Terminals consumed by runs of a star. The slots are allocated up front
+//and each is written once, past the end of every run sharing the buffer,
+//so the results handed out over them never see them change or move
+template<class T>
+struct RunBuffer {
+	std::vector<T> slots;
+	//slots written so far
+	std::size_t filled;
+
+	RunBuffer(const T* begin, const T* end, std::size_t capacity) : slots(capacity), filled(end-begin) {
+		std::copy(begin,end,slots.begin());
+	}
+
+	//the first length terminals as a buffer results can share
+	std::shared_ptr<const std::vector<T>> shared(const std::shared_ptr<RunBuffer>& self) const {
+		return std::shared_ptr<const std::vector<T>>(self,&slots);
+	}
+};
+
 //Kleene Star
 template<class T, class A>
-class Rep: public Parser<T,std::vector<A>> {
+class Rep: public Parser<T,Seq<A>> {
  	private:
 		std::shared_ptr<Parser<T,A>> internal;
 	public:
 		Rep() {
-			Parser<T,std::vector<A>>::isEmptySet(false);
-			Parser<T,std::vector<A>>::isNullableSet(true);
-			std::set<std::vector<A>> retset;
-			retset.insert(std::vector<A>());
-			Parser<T,std::vector<A>>::parseNullSet(retset);
+			Parser<T,Seq<A>>::isEmptySet(false);
+			Parser<T,Seq<A>>::isNullableSet(true);
+			Forest<Seq<A>> retset;
+			retset.insert(Seq<A>());
+			Parser<T,Seq<A>>::parseNullSet(std::move(retset));
 		}
 
 		void setParser(std::shared_ptr<Parser<T,A>> input) { internal = input;};
 		
 		virtual std::vector<void*> getChildren() {
 			std::vector<void*> temp;
-			temp.push_back(internal);
+			temp.push_back(internal.get());
 			return temp;
 		}
 
@@ -593,22 +1720,44 @@ class Rep: public Parser<T,std::vector<A>> {
 		std::string getLabel() override {
 			return "Kleene";
 		}
+
 	
 	protected:
+		//over a terminal class the star can take the whole run at once
+		virtual const T* internalRunExtent(const RunStep<T>& step) override {
+			return internal->scanClass(step.begin,step.end);
+		}
+
+		virtual std::shared_ptr<Parser<T,Seq<A>>> internalDeriveRun(const RunStep<T>& step) override {
+			Parser<T,Seq<A>>::reportBuilt();
+			return startRun(step.begin,step.stop);
+		}
 	
-	static std::vector<A> reductionOperation(std::pair<A,std::vector<A>> input) {
-					std::vector<A> retval; 
-					retval.push_back(input.first);
-					retval.insert(retval.begin(),input.second.begin(),input.second.end());
-					return retval;
+	//prepending to the persistent sequence shares the tail so collecting
+	//N repetitions is linear rather than quadratic
+	static Seq<A> reductionOperation(std::pair<A,Seq<A>>&& input) {
+					return Seq<A>(std::move(input.first),std::move(input.second));
+	}
+
+	std::shared_ptr<Parser<T,Seq<A>>> startRun(const T* begin, const T* end) {
+		auto tokens = std::make_shared<RunBuffer<T>>(begin,end,end-begin);
+		return std::make_shared<Run<T,A>>(internal,Parser<T,Seq<A>>::shared_from_this(),tokens,tokens->filled);
 	}
 	
-	virtual std::shared_ptr<Parser<T,std::vector<A>>> internalDerive(T t, typename Parser<T,std::vector<A>>::ParserCache& cache) override {
-			auto retval = std::make_shared<Red<T,std::pair<A,std::vector<A>>,std::vector<A>>>(Rep<T,A>::reductionOperation);
+	virtual std::shared_ptr<Parser<T,Seq<A>>> internalDerive(T t, typename Parser<T,Seq<A>>::ParserCache& cache) override {
+			//the derivative over a terminal class is the star again with t
+			//recorded in front, so skip building the reduction chain
+			if(internal->scanClass(&t,&t+1) != &t) {
+				auto retval = startRun(&t,&t+1);
+				cache.insert(std::make_pair(t,retval));
+				return retval;
+			}
+
+			auto retval = std::make_shared<Red<T,std::pair<A,Seq<A>>,Seq<A>>>(Rep<T,A>::reductionOperation);
 			cache.insert(std::make_pair(t,retval));
-			auto catenation = std::make_shared<Con<T,A,std::vector<A>>>();
+			auto catenation = std::make_shared<Con<T,A,Seq<A>>>();
 			catenation->setLeft(internal->derive(t));
-			catenation->setRight(Parser<T,std::vector<A>>::shared_from_this());
+			catenation->setRight(Parser<T,Seq<A>>::shared_from_this());
 			retval->setParser(catenation);
 			return retval;
 		}
@@ -617,6 +1766,136 @@ class Rep: public Parser<T,std::vector<A>> {
 		virtual void oneShotUpdate(ChangeCell& change) override {
 				internal->updateChildBasedAttributes(change);
 		}
+
+		virtual void allUpdate(ChangeCell& change) override {
+			if(!Parser<T,Seq<A>>::needsUpdate(internal->attributeVersion()))
+				return;
+			change.orWith(Parser<T,Seq<A>>::firstTokensSet(internal->firstTokensSoFar()));
+		}
+};
+
+//a run over a class that returns the terminals themselves is just a
+//span of the run buffer
+template<class T>
+Forest<Seq<T>> prependRun(Parser<T,T>*, const std::shared_ptr<RunBuffer<T>>& tokens, std::size_t length, const Forest<Seq<T>>& tails) {
+	Forest<Seq<T>> retval;
+	auto buffer = tokens->shared(tokens);
+	for(auto i=tails.begin();i!=tails.end();++i) {
+		retval.insert(Seq<T>(buffer,0,length,*i));
+	}
+	return retval;
+}
+
+//otherwise fold the results of each terminal on one at a time
+template<class T, class A>
+Forest<Seq<A>> prependRun(Parser<T,A>* internal, const std::shared_ptr<RunBuffer<T>>& tokens, std::size_t length, const Forest<Seq<A>>& tails) {
+	Forest<Seq<A>> retval = tails;
+	for(std::size_t i=length;i>0;--i) {
+		Forest<A> heads = internal->derive(tokens->slots[i-1])->parseNull();
+		Forest<Seq<A>> folded;
+		for(auto h=heads.begin();h!=heads.end();++h) {
+			for(auto v=retval.begin();v!=retval.end();++v) {
+				folded.insert(Seq<A>(*h,*v));
+			}
+		}
+		retval = std::move(folded);
+	}
+	return retval;
+}
+
+//Kleene Star over a terminal class part way through a run of the class.
+//The consumed terminals are kept as a span of a shared buffer instead of
+//one reduction chain per terminal
+template<class T, class A>
+class Run: public Parser<T,Seq<A>> {
+	private:
+		std::shared_ptr<Parser<T,A>> internal;
+		std::shared_ptr<Parser<T,Seq<A>>> star;
+		std::shared_ptr<RunBuffer<T>> tokens;
+		std::size_t length;
+	public:
+		Run(std::shared_ptr<Parser<T,A>> internal, std::shared_ptr<Parser<T,Seq<A>>> star, std::shared_ptr<RunBuffer<T>> tokens, std::size_t length) :
+			internal(internal), star(star), tokens(tokens), length(length) {
+			//the star is never empty and always nullable
+			Parser<T,Seq<A>>::isEmptySet(false);
+			Parser<T,Seq<A>>::isNullableSet(true);
+		}
+
+		//number of terminals consumed by the run so far
+		std::size_t count() const {
+			return length;
+		}
+
+		virtual std::vector<void*> getChildren() {
+			std::vector<void*> temp;
+			temp.push_back(star.get());
+			return temp;
+		}
+
+		virtual void recurseChildren(Graph& valueSet) {
+			star->treeRecurse(valueSet);
+		};
+
+		std::string getLabel() override {
+			return "KleeneRun";
+		}
+
+		virtual void release() override {
+			internal.reset();
+			star.reset();
+		}
+
+	protected:
+		virtual const T* internalRunExtent(const RunStep<T>& step) override {
+			return internal->scanClass(step.begin,step.end);
+		}
+
+		virtual std::shared_ptr<Parser<T,Seq<A>>> internalDeriveRun(const RunStep<T>& step) override {
+			Parser<T,Seq<A>>::reportBuilt();
+			return extend(step.begin,step.stop);
+		}
+
+		std::shared_ptr<Parser<T,Seq<A>>> extend(const T* begin, const T* end) {
+			std::shared_ptr<RunBuffer<T>> buffer = tokens;
+			std::size_t needed = length + (end - begin);
+			if(buffer->filled != length || needed > buffer->slots.size()) {
+				//another derivative already wrote past us or the buffer is
+				//full, branch off a copy twice the size and leave this one as
+				//it is for the results over it
+				const T* kept = buffer->slots.data();
+				buffer = std::make_shared<RunBuffer<T>>(kept,kept+length,std::max(needed,2*length));
+			}
+			std::copy(begin,end,buffer->slots.begin()+length);
+			buffer->filled = needed;
+			return std::make_shared<Run<T,A>>(internal,star,buffer,needed);
+		}
+
+		virtual std::shared_ptr<Parser<T,Seq<A>>> internalDerive(T t, typename Parser<T,Seq<A>>::ParserCache& cache) override {
+			if(internal->scanClass(&t,&t+1) != &t) {
+				auto retval = extend(&t,&t+1);
+				cache.insert(std::make_pair(t,retval));
+				return retval;
+			} else {
+				//outside the class the star cannot continue
+				auto retval = Emp<T,Seq<A>>::canonical();
+				cache.insert(std::make_pair(t,retval));
+				return retval;
+			}
+		}
+
+		virtual void oneShotUpdate(ChangeCell& change) override {
+			internal->updateChildBasedAttributes(change);
+			star->updateChildBasedAttributes(change);
+		}
+
+		//put the recorded terminals back in front of the star result the
+		//same way the chain of reductions would have
+		virtual void allUpdate(ChangeCell& change) override {
+			if(!Parser<T,Seq<A>>::needsUpdate(std::max(internal->attributeVersion(),star->attributeVersion())))
+				return;
+			change.orWith(Parser<T,Seq<A>>::parseNullSet(prependRun(internal.get(),tokens,length,star->parseNullSoFar())));
+			change.orWith(Parser<T,Seq<A>>::firstTokensSet(internal->firstTokensSoFar()));
+		}
 };
 
 std::string ptr2string(void* pointer) {
@@ -0,0 +1,263 @@
+#ifndef YIDPP_PIPELINE_H_
+#define YIDPP_PIPELINE_H_
+#include "parser.h"
+#include <atomic>
+#include <thread>
+#include <string>
+#include <exception>
+
+namespace yidpp {
+		//What the lexer hands the parser, kind is the terminal the grammar
+		//matches on and [begin,end) is where in the source it was found
+		template<class K>
+		struct Token {
+			K kind;
+			std::size_t begin;
+			std::size_t end;
+
+			bool operator==(const Token& other) const {
+				return kind == other.kind && begin == other.begin && end == other.end;
+			}
+
+			bool operator!=(const Token& other) const {
+				return !(*this == other);
+			}
+		};
+
+		//The grammar only sees kinds so that derivatives stay shared between
+		//tokens of the same kind. The consumed tokens come back in input order
+		//so the leaves of a tree can be matched back up with their spans
+		template<class K, class A>
+		struct PipelineResult : public ParseResult<A> {
+			//the tokens the parser consumed
+			std::vector<Token<K>> tokens;
+		};
+
+		//Table driven lexer over bytes. Each rule claims the bytes a token may
+		//start with and the ranges it then extends through, so finding a token
+		//is one table lookup and a scan over the rest of it
+		template<class K>
+		class Scanner {
+			public:
+				//bytes no rule starts with come out as single byte tokens of kind error
+				Scanner(K error) : error(error), table(256,0) {};
+
+				//tokens of kind start with a byte in start and continue through the
+				//bytes in follow, later rules take over bytes claimed by earlier ones
+				void addRule(const std::vector<std::pair<char,char>>& start, K kind, const std::vector<std::pair<char,char>>& follow = std::vector<std::pair<char,char>>()) {
+					claim(start,Rule{kind,follow,false});
+				}
+
+				//runs of these bytes separate tokens and are dropped
+				void addSkip(const std::vector<std::pair<char,char>>& bytes) {
+					claim(bytes,Rule{error,bytes,true});
+				}
+
+				//the next token at or after at with offsets from base, false once
+				//only skipped bytes are left
+				bool next(const char* base, const char*& at, const char* end, Token<K>& token) const {
+					while(at != end) {
+						const char* start = at;
+						std::size_t index = table[static_cast<unsigned char>(*at)];
+						if(index == 0) {
+							++at;
+							token = Token<K>{error,static_cast<std::size_t>(start - base),static_cast<std::size_t>(at - base)};
+							return true;
+						}
+						const Rule& rule = rules[index-1];
+						at = scanRanges(rule.follow.data(),rule.follow.size(),at+1,end);
+						if(!rule.skip) {
+							token = Token<K>{rule.kind,static_cast<std::size_t>(start - base),static_cast<std::size_t>(at - base)};
+							return true;
+						}
+					}
+					return false;
+				}
+
+			private:
+				struct Rule {
+					K kind;
+					std::vector<std::pair<char,char>> follow;
+					bool skip;
+				};
+
+				void claim(const std::vector<std::pair<char,char>>& bytes, Rule rule) {
+					rules.push_back(rule);
+					for(auto& range : bytes) {
+						for(int i=static_cast<unsigned char>(range.first);i<=static_cast<unsigned char>(range.second);++i) {
+							table[i] = rules.size();
+						}
+					}
+				}
+
+				K error;
+				//byte to one past the index of the rule it starts, zero for none
+				std::vector<std::size_t> table;
+				std::vector<Rule> rules;
+		};
+
+		//Queue between exactly one producer thread and one consumer thread
+		//without locks. Each side owns one index and keeps a stale copy of the
+		//other's so the shared cache line is only read when it looks full or empty
+		template<class E>
+		class RingBuffer {
+			public:
+				RingBuffer(std::size_t capacity) : slots(roundUp(capacity)), mask(slots.size()-1), head(0), tailSeen(0), tail(0), headSeen(0), done(false) {};
+
+				//producer side, false when the buffer is full
+				bool push(const E& e) {
+					std::size_t t = tail.load(std::memory_order_relaxed);
+					if(t - headSeen == slots.size()) {
+						headSeen = head.load(std::memory_order_acquire);
+						if(t - headSeen == slots.size())
+							return false;
+					}
+					slots[t & mask] = e;
+					tail.store(t+1,std::memory_order_release);
+					return true;
+				}
+
+				//producer side, nothing more will be pushed
+				void close() {
+					done.store(true,std::memory_order_release);
+				}
+
+				//consumer side, moves up to max elements into out and returns how many
+				std::size_t pop(E* out, std::size_t max) {
+					std::size_t h = head.load(std::memory_order_relaxed);
+					if(tailSeen == h)
+						tailSeen = tail.load(std::memory_order_acquire);
+					std::size_t count = std::min(tailSeen - h,max);
+					for(std::size_t i=0;i<count;++i) {
+						out[i] = slots[(h+i) & mask];
+					}
+					head.store(h+count,std::memory_order_release);
+					return count;
+				}
+
+				//consumer side, true once the producer closed, anything it pushed
+				//before closing can still be popped
+				bool closed() const {
+					return done.load(std::memory_order_acquire);
+				}
+
+			private:
+				static std::size_t roundUp(std::size_t n) {
+					std::size_t retval = 1;
+					while(retval < n)
+						retval <<= 1;
+					return retval;
+				}
+
+				std::vector<E> slots;
+				std::size_t mask;
+				//consumer's line
+				char padHead[64];
+				std::atomic<std::size_t> head;
+				std::size_t tailSeen;
+				//producer's line
+				char padTail[64];
+				std::atomic<std::size_t> tail;
+				std::size_t headSeen;
+				char padDone[64];
+				std::atomic<bool> done;
+		};
+
+		//wait for the other side of a ring buffer, spinning briefly before
+		//giving the core up
+		inline void backoff(unsigned& spins) {
+			if(++spins < 64) {
+#ifdef __SSE2__
+				_mm_pause();
+#endif
+			} else {
+				std::this_thread::yield();
+			}
+		}
+
+		//Scans and parses at the same time on two threads joined by a ring
+		//buffer. The scanner stalls while the buffer is full and the parser
+		//while it is empty, so the pipeline runs at the pace of the slower stage
+		template<class K, class A>
+		class Pipeline {
+			public:
+				//a buffer or chunk of zero tokens could never pass one on, so both
+				//hold at least one
+				Pipeline(const Scanner<K>& scanner, std::shared_ptr<Parser<K,A>> grammar, std::size_t capacity = 4096, std::size_t chunk = 256) :
+					scanner(scanner), grammar(grammar), capacity(std::max<std::size_t>(capacity,1)), chunk(std::max<std::size_t>(chunk,1)) {};
+
+				PipelineResult<K,A> parse(const std::string& text, const Budget& budget = Budget()) {
+					return parse(text.data(),text.data() + text.size(),budget);
+				}
+
+				//the source must stay alive and unchanged until the parse returns
+				PipelineResult<K,A> parse(const char* begin, const char* end, const Budget& budget = Budget()) {
+					RingBuffer<Token<K>> ring(capacity);
+					std::atomic<bool> cancelled(false);
+					std::exception_ptr failure;
+					std::thread lexer([&]() {
+						try {
+							const char* at = begin;
+							Token<K> token;
+							while(!cancelled.load(std::memory_order_relaxed) && scanner.next(begin,at,end,token)) {
+								unsigned spins = 0;
+								while(!ring.push(token)) {
+									if(cancelled.load(std::memory_order_relaxed))
+										break;
+									backoff(spins);
+								}
+							}
+						} catch(...) {
+							failure = std::current_exception();
+						}
+						ring.close();
+					});
+
+					PipelineResult<K,A> result;
+					std::vector<Token<K>> popped(chunk);
+					std::vector<K> kinds(chunk);
+					try {
+						static_cast<ParseResult<A>&>(result) = grammar->parseChunks([&](const K*& first, const K*& last) {
+							unsigned spins = 0;
+							while(true) {
+								//look at closed before popping so nothing pushed ahead of
+								//the close can be missed
+								bool finished = ring.closed();
+								std::size_t count = ring.pop(popped.data(),chunk);
+								if(count != 0) {
+									for(std::size_t i=0;i<count;++i) {
+										kinds[i] = popped[i].kind;
+									}
+									result.tokens.insert(result.tokens.end(),popped.begin(),popped.begin() + count);
+									first = kinds.data();
+									last = first + count;
+									return true;
+								}
+								if(finished)
+									return false;
+								backoff(spins);
+							}
+						},budget);
+					} catch(...) {
+						cancelled.store(true,std::memory_order_relaxed);
+						lexer.join();
+						throw;
+					}
+					//a parse stopped by its budget leaves the scanner waiting on a full buffer
+					cancelled.store(true,std::memory_order_relaxed);
+					lexer.join();
+					if(failure)
+						std::rethrow_exception(failure);
+					result.tokens.resize(result.stats.tokens);
+					return result;
+				}
+
+			private:
+				Scanner<K> scanner;
+				std::shared_ptr<Parser<K,A>> grammar;
+				std::size_t capacity;
+				std::size_t chunk;
+		};
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "parser.h"
+#include "check.h"
+using namespace yidpp;
+
+typedef std::string S;
+typedef std::shared_ptr<Parser<char,S>> P;
+
+//balanced parenthesis lists, ambiguous in how the lists are split
+P braces() {
+	auto open = std::make_shared<EqT<char>>('(');
+	auto close = std::make_shared<EqT<char>>(')');
+	auto list = std::make_shared<Alt<char,S>>();
+	auto pair = std::make_shared<Con<char,char,char>>();
+	pair->setLeft(open);
+	pair->setRight(close);
+	auto pairRed = std::make_shared<Red<char,std::pair<char,char>,S>>([](std::pair<char,char>) { return S("()"); });
+	pairRed->setParser(pair);
+	auto nested = std::make_shared<Con<char,char,S>>();
+	nested->setLeft(open);
+	nested->setRight(list);
+	auto nestedRed = std::make_shared<Red<char,std::pair<char,S>,S>>([](std::pair<char,S> p) { return "(" + p.second; });
+	nestedRed->setParser(nested);
+	auto wrapped = std::make_shared<Con<char,S,char>>();
+	wrapped->setLeft(nestedRed);
+	wrapped->setRight(close);
+	auto wrappedRed = std::make_shared<Red<char,std::pair<S,char>,S>>([](std::pair<S,char> p) { return p.first + ")"; });
+	wrappedRed->setParser(wrapped);
+	auto twice = std::make_shared<Con<char,S,S>>();
+	twice->setLeft(list);
+	twice->setRight(list);
+	auto twiceRed = std::make_shared<Red<char,std::pair<S,S>,S>>([](std::pair<S,S> p) { return "[" + p.first + p.second + "]"; });
+	twiceRed->setParser(twice);
+	list->addParser(wrappedRed);
+	list->addParser(twiceRed);
+	list->addParser(pairRed);
+	return list;
+}
+
+std::set<S> plain(P p, const S& input) {
+	for(auto c : input)
+		p = p->derive(c);
+	return p->parseNull();
+}
+
+std::vector<char> chars(const S& input) {
+	return std::vector<char>(input.begin(),input.end());
+}
+
+//a stopped parse leaves the grammar as it was, so parsing with it again
+//gives the same forests as a fresh grammar
+void stopsAndReuses(const Budget& budget, ParseStatus status) {
+	S input = "()()()()()()";
+	auto expected = plain(braces(),input);
+	P grammar = braces();
+	auto stopped = grammar->parseLimited(chars(input),budget);
+	CHECK(stopped.status == status);
+	CHECK(stopped.forest.empty());
+	CHECK(plain(grammar,input) == expected);
+	auto again = grammar->parseLimited(chars(input),Budget());
+	CHECK(again.complete() && std::set<S>(again.forest) == expected);
+}
+
+//two sides of a few thousand trees each
+std::shared_ptr<Parser<char,std::pair<int,int>>> product(int size) {
+	Forest<int> trees;
+	for(int i=0;i<size;++i)
+		trees.insert(i);
+	auto both = std::make_shared<Con<char,int,int>>();
+	both->setLeft(std::make_shared<Eps<char,int>>(trees));
+	both->setRight(std::make_shared<Eps<char,int>>(trees));
+	return both;
+}
+
+int main() {
+	auto full = braces()->parseLimited(chars("()()()()()()"),Budget());
+	CHECK(full.complete());
+	CHECK(std::set<S>(full.forest) == plain(braces(),"()()()()()()"));
+	CHECK(full.stats.tokens == 12);
+	CHECK(full.stats.nodes > 0);
+
+	Budget forest;
+	forest.maxForest = 5;
+	stopsAndReuses(forest,ParseStatus::ForestBudgetExceeded);
+	Budget nodes;
+	nodes.maxNodes = 20;
+	stopsAndReuses(nodes,ParseStatus::NodeBudgetExceeded);
+	Budget passes;
+	passes.maxIterations = 3;
+	stopsAndReuses(passes,ParseStatus::IterationBudgetExceeded);
+
+	//the product of two large forests is refused before it is built
+	Budget small;
+	small.maxForest = 100;
+	small.timeLimit = std::chrono::milliseconds(10);
+	auto refused = product(4000)->parseLimited(std::vector<char>(),small);
+	CHECK(refused.status == ParseStatus::ForestBudgetExceeded);
+	CHECK(refused.stats.largestForest <= 100);
+	CHECK(refused.stats.trees == 0);
+
+	//and without a size limit the deadline still stops it part way
+	Budget deadline;
+	deadline.timeLimit = std::chrono::milliseconds(10);
+	auto late = product(4000)->parseLimited(std::vector<char>(),deadline);
+	CHECK(late.status == ParseStatus::DeadlineExceeded);
+	CHECK(late.stats.trees < 4000*4000);
+
+	//derivatives built while fast forwarding through a run count as well
+	auto digits = std::make_shared<Cls<char>>('0','9');
+	auto number = std::make_shared<Rep<char,char>>();
+	number->setParser(digits);
+	auto statement = std::make_shared<Con<char,Seq<char>,char>>();
+	statement->setLeft(number);
+	statement->setRight(std::make_shared<EqT<char>>(';'));
+	auto counted = statement->parseLimited(chars("123456789;"),Budget());
+	CHECK(counted.complete() && counted.forest.size() == 1);
+	CHECK(counted.stats.nodes >= 2);
+	Budget one;
+	one.maxNodes = 1;
+	CHECK(statement->parseLimited(chars("123456789;"),one).status == ParseStatus::NodeBudgetExceeded);
+	return checkResult();
+}
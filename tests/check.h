@@ -0,0 +1,20 @@
+#ifndef YIDPP_TESTS_CHECK_H_
+#define YIDPP_TESTS_CHECK_H_
+#include <iostream>
+
+//Minimal assertions for the test programs. A failed check is reported
+//and the program exits non zero through checkResult
+static int checkFailures = 0;
+
+#define CHECK(cond) do { \
+	if(!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+		++checkFailures; \
+	} \
+} while(0)
+
+inline int checkResult() {
+	return checkFailures == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "parser.h"
+#include "check.h"
+using namespace yidpp;
+
+typedef std::string S;
+typedef std::shared_ptr<Parser<char,S>> P;
+
+std::shared_ptr<EqT<char>> terminal(char c) {
+	return std::make_shared<EqT<char>>(c);
+}
+
+P epsilon() {
+	Forest<S> e;
+	e.insert("");
+	return std::make_shared<Eps<char,S>>(e);
+}
+
+P text(std::shared_ptr<Parser<char,char>> p) {
+	auto retval = std::make_shared<Red<char,char,S>>([](char c) { return S(1,c); });
+	retval->setParser(p);
+	return retval;
+}
+
+P join(P left, P right) {
+	auto both = std::make_shared<Con<char,S,S>>();
+	both->setLeft(left);
+	both->setRight(right);
+	auto retval = std::make_shared<Red<char,std::pair<S,S>,S>>([](std::pair<S,S> p) { return p.first + p.second; });
+	retval->setParser(both);
+	return retval;
+}
+
+//L = L 'a' | e
+P leftRecursive() {
+	auto l = std::make_shared<Alt<char,S>>();
+	l->addParser(join(l,text(terminal('a'))));
+	l->addParser(epsilon());
+	return l;
+}
+
+//R = 'b' R | e
+P rightRecursive() {
+	auto r = std::make_shared<Alt<char,S>>();
+	r->addParser(join(text(terminal('b')),r));
+	r->addParser(epsilon());
+	return r;
+}
+
+std::set<S> parse(P p, const S& input) {
+	for(auto c : input)
+		p = p->derive(c);
+	return p->parseNull();
+}
+
+int main() {
+	P l = leftRecursive();
+	CHECK(l->firstTokens().contains('a'));
+	CHECK(!l->firstTokens().contains('b'));
+	P r = rightRecursive();
+	CHECK(r->firstTokens().contains('b'));
+	CHECK(!r->firstTokens().contains('a'));
+
+	//a nullable left side lets the right side's terminals through
+	P lr = join(l,r);
+	CHECK(lr->firstTokens().contains('a'));
+	CHECK(lr->firstTokens().contains('b'));
+	CHECK(!lr->firstTokens().contains('c'));
+	P lrc = join(lr,text(terminal('c')));
+	CHECK(lrc->firstTokens().contains('c'));
+	CHECK(!join(text(terminal('c')),lr)->firstTokens().contains('a'));
+
+	//terminals outside FIRST derive to the shared empty parser without
+	//building anything
+	CHECK(lr->derive('c') == (Emp<char,S>::canonical()));
+	CHECK(l->derive('b') == (Emp<char,S>::canonical()));
+
+	//pruning does not lose parses
+	CHECK(parse(lr,"aab") == std::set<S>({"aab"}));
+	CHECK(parse(lrc,"abbc") == std::set<S>({"abbc"}));
+	CHECK(parse(lrc,"c") == std::set<S>({"c"}));
+	CHECK(parse(lrc,"ba").empty());
+
+	//byte sized enums keep their FIRST set as a bitset
+	enum class Kind : unsigned char { Word, Number, Stop };
+	FirstSet<Kind> kinds;
+	kinds.insertRange(Kind::Word,Kind::Number);
+	CHECK(kinds.contains(Kind::Word) && kinds.contains(Kind::Number) && !kinds.contains(Kind::Stop));
+	return checkResult();
+}
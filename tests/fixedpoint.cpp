@@ -0,0 +1,85 @@
+#include "parser.h"
+#include "check.h"
+using namespace yidpp;
+
+typedef std::string S;
+typedef std::shared_ptr<Parser<char,S>> P;
+
+//S = S 'a' | 'b' S | e, left and right recursive and nullable. With
+//twice set the grammar is S S instead
+P grammar(bool twice) {
+	auto s = std::make_shared<Alt<char,S>>();
+	auto a = std::make_shared<EqT<char>>('a');
+	auto b = std::make_shared<EqT<char>>('b');
+	auto left = std::make_shared<Con<char,S,char>>();
+	left->setLeft(s);
+	left->setRight(a);
+	auto leftRed = std::make_shared<Red<char,std::pair<S,char>,S>>([](std::pair<S,char> p) { return "(" + p.first + "a)"; });
+	leftRed->setParser(left);
+	auto right = std::make_shared<Con<char,char,S>>();
+	right->setLeft(b);
+	right->setRight(s);
+	auto rightRed = std::make_shared<Red<char,std::pair<char,S>,S>>([](std::pair<char,S> p) { return "(b" + p.second + ")"; });
+	rightRed->setParser(right);
+	Forest<S> e;
+	e.insert("e");
+	s->addParser(leftRed);
+	s->addParser(rightRed);
+	s->addParser(std::make_shared<Eps<char,S>>(e));
+	if(!twice)
+		return s;
+	auto both = std::make_shared<Con<char,S,S>>();
+	both->setLeft(s);
+	both->setRight(s);
+	auto bothRed = std::make_shared<Red<char,std::pair<S,S>,S>>([](std::pair<S,S> p) { return "[" + p.first + p.second + "]"; });
+	bothRed->setParser(both);
+	return bothRed;
+}
+
+//derive through the input, optionally asking for emptiness after every
+//step the way the parse loop does
+std::set<S> parse(bool twice, const S& input, bool probe) {
+	P p = grammar(twice);
+	if(probe)
+		p->isEmpty();
+	for(auto c : input) {
+		p = p->derive(c);
+		if(probe)
+			p->isEmpty();
+	}
+	return p->parseNull();
+}
+
+void expect(bool twice, const S& input, const std::set<S>& trees) {
+	CHECK(parse(twice,input,false) == trees);
+	CHECK(parse(twice,input,true) == trees);
+	auto limited = grammar(twice)->parseLimited(std::vector<char>(input.begin(),input.end()),Budget());
+	CHECK(limited.complete() && std::set<S>(limited.forest) == trees);
+}
+
+int main() {
+	expect(false,"",{"e"});
+	expect(false,"a",{"(ea)"});
+	expect(false,"b",{"(be)"});
+	expect(false,"ab",{});
+	expect(false,"ba",{"((be)a)","(b(ea))"});
+	expect(false,"bbaa",{"(((b(be))a)a)","((b((be)a))a)","((b(b(ea)))a)","(b(((be)a)a))","(b((b(ea))a))","(b(b((ea)a)))"});
+
+	expect(true,"",{"[ee]"});
+	expect(true,"a",{"[(ea)e]","[e(ea)]"});
+	expect(true,"ab",{"[(ea)(be)]"});
+	expect(true,"ba",{"[((be)a)e]","[(b(ea))e]","[(be)(ea)]","[e((be)a)]","[e(b(ea))]"});
+	expect(true,"abba",{"[(ea)((b(be))a)]","[(ea)(b((be)a))]","[(ea)(b(b(ea)))]"});
+	expect(true,"aab",{"[((ea)a)(be)]"});
+	CHECK(parse(true,"bbaa",false).size() == 19);
+	CHECK(parse(true,"bbaa",true).size() == 19);
+
+	//the FIRST sets of the recursive grammar have to see through the
+	//nullable left recursion
+	P s = grammar(false);
+	CHECK(s->firstTokens().contains('a'));
+	CHECK(s->firstTokens().contains('b'));
+	CHECK(!s->firstTokens().contains('c'));
+	CHECK(s->derive('c')->isEmpty());
+	return checkResult();
+}
@@ -0,0 +1,95 @@
+#include "pipeline.h"
+#include "check.h"
+using namespace yidpp;
+
+enum class Kind : unsigned char { Error, Num, Ident, Comma };
+typedef Token<Kind> Tok;
+typedef std::vector<std::pair<char,char>> Ranges;
+typedef std::shared_ptr<Parser<Kind,Seq<Kind>>> P;
+
+Scanner<Kind> scanner() {
+	Scanner<Kind> retval(Kind::Error);
+	retval.addSkip(Ranges{{' ',' '},{'\n','\n'},{'\t','\t'}});
+	retval.addRule(Ranges{{'0','9'}},Kind::Num,Ranges{{'0','9'}});
+	retval.addRule(Ranges{{'a','z'},{'_','_'}},Kind::Ident,Ranges{{'a','z'},{'_','_'},{'0','9'}});
+	retval.addRule(Ranges{{',',','}},Kind::Comma);
+	return retval;
+}
+
+//(Num | Ident)*
+P atoms() {
+	auto atom = std::make_shared<Alt<Kind,Kind>>();
+	atom->addParser(std::make_shared<EqT<Kind>>(Kind::Num));
+	atom->addParser(std::make_shared<EqT<Kind>>(Kind::Ident));
+	auto retval = std::make_shared<Rep<Kind,Kind>>();
+	retval->setParser(atom);
+	return retval;
+}
+
+std::vector<Tok> lex(const std::string& source) {
+	Scanner<Kind> s = scanner();
+	std::vector<Tok> retval;
+	const char* at = source.data();
+	Tok token;
+	while(s.next(source.data(),at,source.data()+source.size(),token))
+		retval.push_back(token);
+	return retval;
+}
+
+std::vector<Kind> kinds(const std::vector<Tok>& tokens) {
+	std::vector<Kind> retval;
+	for(auto& t : tokens)
+		retval.push_back(t.kind);
+	return retval;
+}
+
+int main() {
+	std::string small = "foo 12  bar_9\n 345 x";
+	std::vector<Tok> expected = {
+		{Kind::Ident,0,3},{Kind::Num,4,6},{Kind::Ident,8,13},{Kind::Num,15,18},{Kind::Ident,19,20}
+	};
+	CHECK(lex(small) == expected);
+	CHECK(lex("a#")[1] == (Tok{Kind::Error,1,2}));
+
+	std::string big;
+	for(int i=0;i<150;++i) {
+		big += (i%3 == 0 ? "x" : "") + std::to_string(i);
+		big += (i%7 == 0 ? "\n" : " ");
+	}
+	std::vector<Tok> bigTokens = lex(big);
+	auto direct = atoms()->parseLimited(kinds(bigTokens),Budget());
+	CHECK(direct.complete() && direct.forest.size() == 1);
+
+	//tiny buffers and chunks keep both threads waiting on each other, and
+	//zero is taken as one
+	for(std::size_t capacity : {0,1,3,4096}) {
+		for(std::size_t chunk : {0,1,7,256}) {
+			Pipeline<Kind,Seq<Kind>> pipeline(scanner(),atoms(),capacity,chunk);
+			auto r = pipeline.parse(small);
+			CHECK(r.complete() && r.forest.size() == 1);
+			CHECK(r.tokens == expected);
+			CHECK(r.forest.begin()->toVector() == kinds(expected));
+			auto b = pipeline.parse(big);
+			CHECK(b.complete() && b.forest == direct.forest);
+			CHECK(b.tokens == bigTokens);
+			CHECK(b.stats.tokens == bigTokens.size());
+		}
+	}
+
+	//the grammar rejects commas, the pipeline still finishes
+	Pipeline<Kind,Seq<Kind>> pipeline(scanner(),atoms(),4,2);
+	auto rejected = pipeline.parse("foo , bar");
+	CHECK(rejected.complete() && rejected.forest.empty());
+
+	//a budget stop with the scanner blocked on a full buffer, then reuse
+	Budget budget;
+	budget.maxNodes = 50;
+	auto stopped = pipeline.parse(big,budget);
+	CHECK(stopped.status == ParseStatus::NodeBudgetExceeded);
+	CHECK(stopped.forest.empty());
+	CHECK(stopped.tokens.size() == stopped.stats.tokens);
+	CHECK(stopped.tokens.size() < bigTokens.size());
+	auto again = pipeline.parse(small);
+	CHECK(again.complete() && again.tokens == expected && again.forest.size() == 1);
+	return checkResult();
+}
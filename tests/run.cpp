@@ -0,0 +1,166 @@
+#include "parser.h"
+#include "check.h"
+using namespace yidpp;
+
+//every way of asking whether a byte is in a class has to agree, whether
+//the byte is scanned sixteen at a time or on its own
+void rangesAgree(char lo, char hi) {
+	std::pair<char,char> range(lo,hi);
+	Cls<char> cls(lo,hi);
+	std::vector<char> bytes;
+	for(int i=0;i<256;++i)
+		bytes.push_back(static_cast<char>(i));
+	for(auto c : bytes) {
+		bool member = cls.scanClass(&c,&c+1) != &c;
+		std::vector<char> block(40,c);
+		const char* stop = scanRanges(&range,1,block.data(),block.data()+block.size());
+		CHECK(stop == (member ? block.data()+block.size() : block.data()));
+		CHECK(cls.firstTokens().contains(c) == member);
+		CHECK(cls.derive(c)->isEmpty() == !member);
+	}
+}
+
+//deriving a terminal at a time and fast forwarding through runs give
+//the same forests
+template<class A>
+void runsAgree(std::shared_ptr<Parser<char,A>> grammar, const std::string& input) {
+	std::shared_ptr<Parser<char,A>> stepped = grammar;
+	for(auto c : input)
+		stepped = stepped->derive(c);
+	auto ranged = grammar->deriveRange(input.data(),input.data()+input.size());
+	CHECK(stepped->parseNull() == ranged->parseNull());
+}
+
+typedef std::string S;
+typedef std::shared_ptr<Parser<char,S>> P;
+
+std::shared_ptr<Rep<char,char>> star(char lo, char hi) {
+	auto retval = std::make_shared<Rep<char,char>>();
+	retval->setParser(std::make_shared<Cls<char>>(lo,hi));
+	return retval;
+}
+
+P word(std::shared_ptr<Parser<char,Seq<char>>> run) {
+	auto retval = std::make_shared<Red<char,Seq<char>,S>>([](Seq<char> s) {
+		auto v = s.toVector();
+		return S(v.begin(),v.end());
+	});
+	retval->setParser(run);
+	return retval;
+}
+
+//digits* ';' under a union, the usual shape of a statement list
+P statement() {
+	auto body = std::make_shared<Con<char,S,char>>();
+	body->setLeft(word(star('0','9')));
+	body->setRight(std::make_shared<EqT<char>>(';'));
+	auto red = std::make_shared<Red<char,std::pair<S,char>,S>>([](std::pair<S,char> p) { return p.first + ";"; });
+	red->setParser(body);
+	auto top = std::make_shared<Alt<char,S>>();
+	top->addParser(red);
+	return top;
+}
+
+//two choices whose runs end at different places
+P overlapping() {
+	auto top = std::make_shared<Alt<char,S>>();
+	top->addParser(word(star('a','z')));
+	auto pair = std::make_shared<Con<char,S,S>>();
+	pair->setLeft(word(star('a','m')));
+	pair->setRight(word(star('n','z')));
+	auto red = std::make_shared<Red<char,std::pair<S,S>,S>>([](std::pair<S,S> p) { return p.first + "|" + p.second; });
+	red->setParser(pair);
+	top->addParser(red);
+	return top;
+}
+
+//S = S digit | digits*, the union leads back to itself
+P leftRecursive() {
+	auto s = std::make_shared<Alt<char,S>>();
+	auto more = std::make_shared<Con<char,S,char>>();
+	more->setLeft(s);
+	more->setRight(std::make_shared<Cls<char>>('0','9'));
+	auto red = std::make_shared<Red<char,std::pair<S,char>,S>>([](std::pair<S,char> p) { return "(" + p.first + p.second + ")"; });
+	red->setParser(more);
+	s->addParser(red);
+	s->addParser(word(star('0','9')));
+	return s;
+}
+
+//level = lower | lower op level, every level reaches the one below
+//along both choices
+P layered(int levels) {
+	P lower = word(star('0','9'));
+	for(int k=0;k<levels;++k) {
+		auto level = std::make_shared<Alt<char,S>>();
+		auto tail = std::make_shared<Con<char,char,S>>();
+		tail->setLeft(std::make_shared<EqT<char>>('a'+k));
+		tail->setRight(level);
+		auto both = std::make_shared<Con<char,S,std::pair<char,S>>>();
+		both->setLeft(lower);
+		both->setRight(tail);
+		auto red = std::make_shared<Red<char,std::pair<S,std::pair<char,S>>,S>>([](std::pair<S,std::pair<char,S>> p) { return "(" + p.first + p.second.first + p.second.second + ")"; });
+		red->setParser(both);
+		level->addParser(lower);
+		level->addParser(red);
+		lower = level;
+	}
+	return lower;
+}
+
+//fast forwarding builds no more than deriving one terminal at a time
+void sharedCost(int levels, const std::string& input) {
+	std::vector<char> terminals(input.begin(),input.end());
+	auto ranged = layered(levels)->parseLimited(terminals,Budget());
+	std::size_t at = 0;
+	auto stepped = layered(levels)->parseChunks([&](const char*& begin, const char*& end) {
+		if(at == terminals.size())
+			return false;
+		begin = terminals.data() + at;
+		end = begin + 1;
+		++at;
+		return true;
+	},Budget());
+	CHECK(ranged.complete() && stepped.complete());
+	CHECK(ranged.forest == stepped.forest && ranged.forest.size() == 1);
+	CHECK(ranged.stats.nodes <= stepped.stats.nodes);
+	//a handful of derivatives per level and terminal, not one per path
+	CHECK(stepped.stats.nodes <= 40*levels*input.size());
+}
+
+int main() {
+	rangesAgree('0','9');
+	rangesAgree('a','\xff');
+	rangesAgree('\x80','\xbf');
+	rangesAgree('\0','\x7f');
+	//a range ending below its start is empty
+	rangesAgree('z','a');
+
+	std::pair<char,char> high('a','\xff');
+	std::vector<char> accented(40,'\xe9');
+	CHECK(scanRanges(&high,1,accented.data(),accented.data()+40) == accented.data()+40);
+
+	runsAgree(statement(),"123;");
+	runsAgree(statement(),"12a;");
+	runsAgree(overlapping(),"abcxyz");
+	runsAgree(overlapping(),"abcmnoxyz");
+	runsAgree(overlapping(),"xyzabc");
+	runsAgree(leftRecursive(),"1234");
+	runsAgree(leftRecursive(),"12a4");
+
+	//a union at the top still fast forwards, so a long run costs a
+	//handful of derivatives instead of one chain per terminal
+	std::string digits(1000,'7');
+	digits += ';';
+	auto parsed = statement()->parseLimited(std::vector<char>(digits.begin(),digits.end()),Budget());
+	CHECK(parsed.complete() && parsed.forest.size() == 1);
+	CHECK(parsed.forest.begin()->size() == digits.size());
+	CHECK(parsed.stats.nodes < 20);
+
+	//shared sub-grammars are derived once per run, not once per path
+	sharedCost(20,std::string(50,'7'));
+	sharedCost(12,"7a7a7a7a7a7a7a7a7");
+	sharedCost(12,"123a45b6c789d0");
+	runsAgree(layered(6),"12a34b5");
+	return checkResult();
+}
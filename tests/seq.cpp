@@ -0,0 +1,109 @@
+#include "parser.h"
+#include "check.h"
+using namespace yidpp;
+
+typedef std::shared_ptr<Parser<char,Seq<char>>> P;
+
+//'a' | 'b', not a class so the star builds the reduction chain
+P chain() {
+	auto choice = std::make_shared<Alt<char,char>>();
+	choice->addParser(std::make_shared<EqT<char>>('a'));
+	choice->addParser(std::make_shared<EqT<char>>('b'));
+	auto retval = std::make_shared<Rep<char,char>>();
+	retval->setParser(choice);
+	return retval;
+}
+
+//'a'-'b', a class so the star keeps the terminals as a run
+P run() {
+	auto retval = std::make_shared<Rep<char,char>>();
+	retval->setParser(std::make_shared<Cls<char>>('a','b'));
+	return retval;
+}
+
+std::vector<char> vec(const std::string& s) {
+	return std::vector<char>(s.begin(),s.end());
+}
+
+//the only parse of input, deriving a terminal at a time
+std::vector<char> stepped(P grammar, const std::string& input) {
+	for(auto c : input)
+		grammar = grammar->derive(c);
+	auto forest = grammar->parseNull();
+	CHECK(forest.size() == 1);
+	return forest.empty() ? std::vector<char>() : forest.begin()->toVector();
+}
+
+//the only parse of input, handed over chunk terminals at a time
+std::vector<char> chunked(P grammar, const std::string& input, std::size_t chunk) {
+	std::size_t at = 0;
+	auto result = grammar->parseChunks([&](const char*& begin, const char*& end) {
+		if(at == input.size())
+			return false;
+		begin = input.data() + at;
+		at = std::min(input.size(),at + chunk);
+		end = input.data() + at;
+		return true;
+	},Budget());
+	CHECK(result.complete() && result.forest.size() == 1);
+	return result.forest.empty() ? std::vector<char>() : result.forest.begin()->toVector();
+}
+
+void inOrder(P (*grammar)(), const std::string& input) {
+	CHECK(stepped(grammar(),input) == vec(input));
+	CHECK(chunked(grammar(),input,1) == vec(input));
+	CHECK(chunked(grammar(),input,3) == vec(input));
+	CHECK(chunked(grammar(),input,input.size() + 1) == vec(input));
+}
+
+Seq<char> seq(const std::string& s) {
+	Seq<char> retval;
+	for(auto i=s.rbegin();i!=s.rend();++i)
+		retval = Seq<char>(*i,retval);
+	return retval;
+}
+
+int main() {
+	//repetitions come back in input order on every path
+	inOrder(chain,"abbab");
+	inOrder(run,"abbab");
+	inOrder(chain,"");
+	inOrder(run,"");
+
+	//sequences compare by their elements whether or not they share cells
+	auto buffer = std::make_shared<const std::vector<char>>(vec("abcd"));
+	Seq<char> tail = seq("xy");
+	Seq<char> spanned(buffer,0,2,tail);
+	CHECK(spanned == seq("abxy"));
+	CHECK(!(spanned < seq("abxy")) && !(seq("abxy") < spanned));
+	CHECK(spanned == Seq<char>(buffer,0,2,tail));
+	//same leading span, different rest
+	Seq<char> other(buffer,0,2,seq("xz"));
+	CHECK(spanned != other);
+	CHECK(spanned < other && !(other < spanned));
+	//same buffer, one span a prefix of the other
+	Seq<char> shorter(buffer,0,2,Seq<char>());
+	Seq<char> longer(buffer,0,3,Seq<char>());
+	CHECK(shorter != longer);
+	CHECK(shorter < longer && !(longer < shorter));
+	//different heads in front of the same tail
+	CHECK(Seq<char>('a',tail) < Seq<char>('b',tail));
+	CHECK(Seq<char>('a',tail) != Seq<char>('b',tail));
+	CHECK(Seq<char>('a',tail) == Seq<char>('a',tail));
+	CHECK(seq("ab") < seq("abc") && seq("") < seq("a"));
+
+	//a result stays as it was while the grammar carries on parsing
+	P grammar = run();
+	P held = grammar->derive('a')->derive('b');
+	Seq<char> first = *held->parseNull().begin();
+	const char& element = *first.begin();
+	P carried = held;
+	for(int i=0;i<100;++i)
+		carried = carried->derive(i%2 ? 'a' : 'b');
+	P branched = held->derive('a');
+	CHECK(first.toVector() == vec("ab"));
+	CHECK(element == 'a');
+	CHECK(carried->parseNull().begin()->size() == 102);
+	CHECK(branched->parseNull().begin()->toVector() == vec("aba"));
+	return checkResult();
+}